@@ -5,6 +5,8 @@
 #include <linux/skbuff.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/crc32.h>
 #include <linux/rtnetlink.h>
 #include <linux/version.h>
 #include <linux/kallsyms.h>
@@ -77,6 +79,22 @@ static int register_tap(const char *func_name, void *replacement) {
     num_taps++;
     return 0;
 }
+
+/* Look up a registered tap by symbol name */
+static struct function_tap *find_tap(const char *func_name)
+{
+    struct function_tap *tap = NULL;
+    int i;
+
+    for (i = 0; i < num_taps; i++) {
+        if (strcmp(function_taps[i].name, func_name) == 0) {
+            tap = &function_taps[i];
+            break;
+        }
+    }
+
+    return tap;
+}
 /* Shadow driver states */
 enum shadow_state {
     SHADOW_PASSIVE,    /* Monitoring original driver */
@@ -93,7 +111,7 @@ struct net_device_state {
     unsigned int flags;
     struct net_device_stats stats;
     bool is_up;
-    u32 features;
+    netdev_features_t features;
     unsigned int tx_queue_len;
     /* Enhanced state tracking */
     struct ethtool_cmd ecmd;     /* Ethtool settings */
@@ -164,8 +182,25 @@ static void save_device_state(struct net_device *dev)
             memcpy(&shadow->saved_state.stats, stats, sizeof(struct net_device_stats));
     }
     
-    /* Save ethtool settings - skip for newer kernels that use different API */
-    printk(KERN_INFO "Shadow driver: Ethtool settings save skipped - kernel API changed\n");
+    /* Save ethtool link settings; callers hold RTNL as the ethtool core requires */
+    memset(&shadow->saved_state.ecmd, 0, sizeof(shadow->saved_state.ecmd));
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,6,0)
+    if (dev->ethtool_ops && dev->ethtool_ops->get_link_ksettings) {
+        struct ethtool_link_ksettings ks;
+        struct ethtool_cmd *ecmd = &shadow->saved_state.ecmd;
+        u32 advertising = 0;
+
+        if (__ethtool_get_link_ksettings(dev, &ks) == 0) {
+            ethtool_convert_link_mode_to_legacy_u32(&advertising,
+                                                    ks.link_modes.advertising);
+            ethtool_cmd_speed_set(ecmd, ks.base.speed);
+            ecmd->duplex = ks.base.duplex;
+            ecmd->autoneg = ks.base.autoneg;
+            ecmd->port = ks.base.port;
+            ecmd->advertising = advertising;
+        }
+    }
+#endif
     
     /* Save debug message level - not directly accessible in newer kernels */
     shadow->saved_state.msg_enable = 0; /* Use a safe default */
@@ -184,7 +219,8 @@ static void save_device_state(struct net_device *dev)
      * This is a placeholder to show the concept */
     shadow->saved_state.num_connections = 0;
     
-    printk(KERN_INFO "Shadow driver: Saved enhanced state for device %s\n", dev->name);
+    /* Runs on every UP/DOWN, so keep it out of the console by default */
+    pr_debug("Shadow driver: Saved enhanced state for device %s\n", dev->name);
     /* Comment out add_event until recovery_evaluator is implemented */
     // add_event(NULL, PHASE_NONE, "Saved enhanced state for device %s", dev->name);
 }
@@ -206,17 +242,21 @@ static int restore_device_state(struct net_device *dev)
     /* Restore basic device attributes */
     dev->mtu = shadow->saved_state.mtu;
     
+    /* Since 5.15 dev_addr is mirrored in the address list; go through the helper */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,15,0)
+    eth_hw_addr_set(dev, shadow->saved_state.mac_addr);
+#else
     /* Safe copy of MAC address */
     if (dev->dev_addr) {
         unsigned char *dst = (unsigned char *)dev->dev_addr;
         memcpy(dst, shadow->saved_state.mac_addr, ETH_ALEN);
     }
+#endif
     
     dev->flags = shadow->saved_state.flags;
     dev->tx_queue_len = shadow->saved_state.tx_queue_len;
     
-    /* Restore ethtool settings - skip for newer kernels */
-    printk(KERN_INFO "Shadow driver: Ethtool settings restore skipped - kernel API changed\n");
+    /* Restore ethtool settings - skipped for newer kernels */
     
     /* Debug message level restoration skipped - not directly accessible */
     
@@ -248,7 +288,7 @@ static int restore_device_state(struct net_device *dev)
     if (rtnl_is_locked())
         rtnl_unlock();
     
-    printk(KERN_INFO "Shadow driver: Restored enhanced state for device %s\n", dev->name);
+    pr_debug("Shadow driver: Restored enhanced state for device %s\n", dev->name);
     // add_event(NULL, PHASE_RECOVERY_COMPLETE, "Restored state for device %s", dev->name);
     
     return ret;
@@ -256,17 +296,8 @@ static int restore_device_state(struct net_device *dev)
 
 /* Example replacement for transmit function */
 static netdev_tx_t shadow_ndo_start_xmit(struct sk_buff *skb, struct net_device *dev) {
-    int i;
     netdev_tx_t ret = NETDEV_TX_BUSY;
-    struct function_tap *tap = NULL;
-    
-    /* Find the original function tap */
-    for (i = 0; i < num_taps; i++) {
-        if (strcmp(function_taps[i].name, "ndo_start_xmit") == 0) {
-            tap = &function_taps[i];
-            break;
-        }
-    }
+    struct function_tap *tap = find_tap("e1000_start_xmit");
     
     if (!tap)
         return NETDEV_TX_BUSY;
@@ -290,17 +321,8 @@ static netdev_tx_t shadow_ndo_start_xmit(struct sk_buff *skb, struct net_device
 
 /* Example replacement for open function */
 static int shadow_ndo_open(struct net_device *dev) {
-    int i;
     int ret = -EINVAL;
-    struct function_tap *tap = NULL;
-    
-    /* Find the original function tap */
-    for (i = 0; i < num_taps; i++) {
-        if (strcmp(function_taps[i].name, "e1000_open") == 0) {
-            tap = &function_taps[i];
-            break;
-        }
-    }
+    struct function_tap *tap = find_tap("e1000_open");
     
     if (!tap)
         return -EINVAL;
@@ -321,17 +343,8 @@ static int shadow_ndo_open(struct net_device *dev) {
 
 /* Example replacement for stop function */
 static int shadow_ndo_stop(struct net_device *dev) {
-    int i;
     int ret = -EINVAL;
-    struct function_tap *tap = NULL;
-    
-    /* Find the original function tap */
-    for (i = 0; i < num_taps; i++) {
-        if (strcmp(function_taps[i].name, "e1000_stop") == 0) {
-            tap = &function_taps[i];
-            break;
-        }
-    }
+    struct function_tap *tap = find_tap("e1000_stop");
     
     if (!tap)
         return -EINVAL;
@@ -352,17 +365,8 @@ static int shadow_ndo_stop(struct net_device *dev) {
 
 /* Example replacement for set MAC address function */
 static int shadow_ndo_set_mac_address(struct net_device *dev, void *addr) {
-    int i;
     int ret = -EINVAL;
-    struct function_tap *tap = NULL;
-    
-    /* Find the original function tap */
-    for (i = 0; i < num_taps; i++) {
-        if (strcmp(function_taps[i].name, "e1000_set_mac") == 0) {
-            tap = &function_taps[i];
-            break;
-        }
-    }
+    struct function_tap *tap = find_tap("e1000_set_mac");
     
     if (!tap)
         return -EINVAL;
@@ -379,7 +383,11 @@ static int shadow_ndo_set_mac_address(struct net_device *dev, void *addr) {
         if (dev->addr_assign_type & NET_ADDR_RANDOM)
             dev->addr_assign_type &= ~NET_ADDR_RANDOM;
             
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,15,0)
+        eth_hw_addr_set(dev, addr);
+#else
         memcpy((void *)dev->dev_addr, addr, ETH_ALEN);
+#endif
         ret = 0;
     }
     
@@ -388,17 +396,8 @@ static int shadow_ndo_set_mac_address(struct net_device *dev, void *addr) {
 
 /* Example replacement for change MTU function */
 static int shadow_ndo_change_mtu(struct net_device *dev, int new_mtu) {
-    int i;
     int ret = -EINVAL;
-    struct function_tap *tap = NULL;
-    
-    /* Find the original function tap */
-    for (i = 0; i < num_taps; i++) {
-        if (strcmp(function_taps[i].name, "e1000_change_mtu") == 0) {
-            tap = &function_taps[i];
-            break;
-        }
-    }
+    struct function_tap *tap = find_tap("e1000_change_mtu");
     
     if (!tap)
         return -EINVAL;
@@ -474,7 +473,11 @@ static void recovery_work_fn(struct work_struct *work) {
 /* Network device notifier callback */
 static int netdev_event(struct notifier_block *this, unsigned long event, void *ptr)
 {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,11,0)
+    struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+#else
     struct net_device *dev = (struct net_device *)ptr;  /* Direct cast for older kernels */
+#endif
     struct network_shadow *shadow = shadow_driver;
     
     if (!shadow || !dev)
@@ -484,23 +487,26 @@ static int netdev_event(struct notifier_block *this, unsigned long event, void *
     case NETDEV_REGISTER:
         if (!shadow->dev && strcmp(dev->name, shadow->device_name) == 0) {
             shadow->dev = dev;
-            shadow->state = SHADOW_PASSIVE;
             printk(KERN_INFO "Shadow driver: Started monitoring device %s\n", dev->name);
             // start_test("network_shadow", dev->name);
             // add_event(NULL, PHASE_NONE, "Started monitoring device %s", dev->name);
-            save_device_state(dev);
+            
+            /* A device coming back during recovery gets the old state restored,
+             * so keep the snapshot taken before the failure */
+            if (!shadow->recovery_in_progress) {
+                shadow->state = SHADOW_PASSIVE;
+                save_device_state(dev);
+            }
         }
         break;
         
     case NETDEV_UNREGISTER:
         if (dev == shadow->dev) {
             if (!shadow->recovery_in_progress) {
-                shadow->state = SHADOW_ACTIVE;
-                shadow->recovery_in_progress = true;
                 printk(KERN_INFO "Shadow driver: Device %s unregistered unexpectedly\n", dev->name);
                 // add_event(NULL, PHASE_FAILURE_DETECTED, "Device %s unregistered unexpectedly", dev->name);
                 
-                /* Start the recovery process */
+                /* Start the recovery process; this marks it in progress */
                 printk(KERN_INFO "Shadow driver active: device %s failed, starting recovery\n", dev->name);
                 start_recovery(shadow);
             }
@@ -509,7 +515,7 @@ static int netdev_event(struct notifier_block *this, unsigned long event, void *
         break;
         
     case NETDEV_UP:
-        if (dev == shadow->dev) {
+        if (dev == shadow->dev && !shadow->recovery_in_progress) {
             save_device_state(dev);
         }
         break;
@@ -565,13 +571,324 @@ static const struct file_operations shadow_proc_fops = {
 };
 #endif
 
+/*
+ * Binary checkpoint of the saved device state.  Reading
+ * /proc/network_shadow_state returns one checkpoint; writing one back
+ * replaces the saved state of the monitored device, e.g. to carry it
+ * across a reload of this module.  All fields are little endian
+ * and the CRC covers everything after the header.  It is the standard
+ * CRC-32 (IEEE 802.3, as computed by zlib's crc32()), so offline tools
+ * can verify archived checkpoints without reimplementing it.
+ */
+#define SHADOW_CKPT_MAGIC   0x4b435353  /* "SSCK" */
+#define SHADOW_CKPT_VERSION 1
+
+/*
+ * Every struct net_device_stats counter, in declaration order from
+ * rx_packets to tx_compressed.
+ */
+#define SHADOW_CKPT_NSTATS 23
+
+/* Flag bits an imported checkpoint may carry */
+#define SHADOW_CKPT_VALID_FLAGS ((IFF_ECHO << 1) - 1)
+
+struct shadow_ckpt_header {
+    __le32 magic;
+    __le16 version;
+    __le16 length;      /* Size of the record that follows */
+    __le32 crc;         /* CRC-32 of the record */
+} __packed;
+
+struct shadow_ckpt_record {
+    char name[IFNAMSIZ];
+    u8 mac_addr[ETH_ALEN];
+    u8 perm_addr[ETH_ALEN];
+    __le32 mtu;
+    __le32 flags;
+    __le64 features;
+    __le32 tx_queue_len;
+    __le32 msg_enable;
+    u8 is_up;
+    /* Ethtool link settings, zero if the driver does not report them */
+    u8 duplex;
+    u8 autoneg;
+    u8 port;
+    __le32 speed;
+    __le32 advertising;
+    /* Statistics offsets */
+    __le64 stats[SHADOW_CKPT_NSTATS];
+} __packed;
+
+struct shadow_ckpt {
+    struct shadow_ckpt_header hdr;
+    struct shadow_ckpt_record rec;
+} __packed;
+
+static u32 shadow_ckpt_crc(const void *buf, size_t len)
+{
+    return ~crc32_le(~0, buf, len);
+}
+
+static void export_checkpoint(struct net_device_state *st, struct shadow_ckpt *ck)
+{
+    struct shadow_ckpt_record *rec = &ck->rec;
+    const unsigned long *counters = (const unsigned long *)&st->stats;
+    int i;
+
+    /* net_device_stats is a plain array of unsigned long counters */
+    BUILD_BUG_ON(sizeof(st->stats) != SHADOW_CKPT_NSTATS * sizeof(unsigned long));
+
+    memset(ck, 0, sizeof(*ck));
+    memcpy(rec->name, st->name, IFNAMSIZ);
+    memcpy(rec->mac_addr, st->mac_addr, ETH_ALEN);
+    memcpy(rec->perm_addr, st->perm_addr, ETH_ALEN);
+    rec->mtu = cpu_to_le32(st->mtu);
+    rec->flags = cpu_to_le32(st->flags);
+    rec->features = cpu_to_le64(st->features);
+    rec->tx_queue_len = cpu_to_le32(st->tx_queue_len);
+    rec->msg_enable = cpu_to_le32(st->msg_enable);
+    rec->is_up = st->is_up;
+    rec->duplex = st->ecmd.duplex;
+    rec->autoneg = st->ecmd.autoneg;
+    rec->port = st->ecmd.port;
+    rec->speed = cpu_to_le32(ethtool_cmd_speed(&st->ecmd));
+    rec->advertising = cpu_to_le32(st->ecmd.advertising);
+    for (i = 0; i < SHADOW_CKPT_NSTATS; i++)
+        rec->stats[i] = cpu_to_le64(counters[i]);
+
+    ck->hdr.magic = cpu_to_le32(SHADOW_CKPT_MAGIC);
+    ck->hdr.version = cpu_to_le16(SHADOW_CKPT_VERSION);
+    ck->hdr.length = cpu_to_le16(sizeof(*rec));
+    ck->hdr.crc = cpu_to_le32(shadow_ckpt_crc(rec, sizeof(*rec)));
+}
+
+/*
+ * restore_device_state() writes mtu, flags, tx_queue_len and the MAC
+ * address straight into the device, so reject values the device could never have had.
+ */
+static int validate_checkpoint(const struct shadow_ckpt_record *rec,
+                               struct net_device *dev)
+{
+    unsigned int mtu = le32_to_cpu(rec->mtu);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+    unsigned int min_mtu = dev->min_mtu;
+    unsigned int max_mtu = dev->max_mtu ? dev->max_mtu : UINT_MAX;
+#else
+    unsigned int min_mtu = 68;
+    unsigned int max_mtu = UINT_MAX;
+#endif
+
+    if (strnlen(rec->name, IFNAMSIZ) == IFNAMSIZ)
+        return -EINVAL;
+
+    if (mtu < min_mtu || mtu > max_mtu)
+        return -EINVAL;
+
+    if (!is_valid_ether_addr(rec->mac_addr))
+        return -EINVAL;
+
+    if (le32_to_cpu(rec->flags) & ~SHADOW_CKPT_VALID_FLAGS)
+        return -EINVAL;
+
+    /* Qdiscs size their rings from tx_queue_len as an int */
+    if (le32_to_cpu(rec->tx_queue_len) > INT_MAX)
+        return -EINVAL;
+
+    return 0;
+}
+
+static int import_checkpoint(const struct shadow_ckpt *ck, struct net_device *dev,
+                             struct net_device_state *st)
+{
+    const struct shadow_ckpt_record *rec = &ck->rec;
+    unsigned long *counters;
+    int ret, i;
+
+    if (le32_to_cpu(ck->hdr.magic) != SHADOW_CKPT_MAGIC ||
+        le16_to_cpu(ck->hdr.version) != SHADOW_CKPT_VERSION ||
+        le16_to_cpu(ck->hdr.length) != sizeof(*rec))
+        return -EINVAL;
+
+    if (le32_to_cpu(ck->hdr.crc) != shadow_ckpt_crc(rec, sizeof(*rec)))
+        return -EBADMSG;
+
+    ret = validate_checkpoint(rec, dev);
+    if (ret)
+        return ret;
+
+    memset(st, 0, sizeof(*st));
+    memcpy(st->name, rec->name, IFNAMSIZ);
+    memcpy(st->mac_addr, rec->mac_addr, ETH_ALEN);
+    memcpy(st->perm_addr, rec->perm_addr, ETH_ALEN);
+    st->mtu = le32_to_cpu(rec->mtu);
+    st->flags = le32_to_cpu(rec->flags);
+    st->features = le64_to_cpu(rec->features);
+    st->tx_queue_len = le32_to_cpu(rec->tx_queue_len);
+    st->msg_enable = le32_to_cpu(rec->msg_enable);
+    st->is_up = rec->is_up;
+    st->ecmd.duplex = rec->duplex;
+    st->ecmd.autoneg = rec->autoneg;
+    st->ecmd.port = rec->port;
+    ethtool_cmd_speed_set(&st->ecmd, le32_to_cpu(rec->speed));
+    st->ecmd.advertising = le32_to_cpu(rec->advertising);
+    counters = (unsigned long *)&st->stats;
+    for (i = 0; i < SHADOW_CKPT_NSTATS; i++)
+        counters[i] = le64_to_cpu(rec->stats[i]);
+
+    return 0;
+}
+
+/*
+ * Snapshot the saved state as a checkpoint.  The notifier runs under RTNL,
+ * so take it to get a consistent copy.  Nothing has been saved until the
+ * monitored device was seen or a checkpoint imported.
+ */
+static int shadow_export_checkpoint(struct network_shadow *shadow,
+                                    struct shadow_ckpt *ck)
+{
+    int ret = 0;
+
+    rtnl_lock();
+    if (shadow->saved_state.name[0] == '\0')
+        ret = -ENODATA;
+    else
+        export_checkpoint(&shadow->saved_state, ck);
+    rtnl_unlock();
+
+    return ret;
+}
+
+/* Readers get one snapshot per open, so short reads never mix two of them */
+static int shadow_state_open(struct inode *inode, struct file *file)
+{
+    struct network_shadow *shadow = shadow_driver;
+    struct shadow_ckpt *ck;
+
+    if (!shadow)
+        return -EINVAL;
+
+    if (!(file->f_mode & FMODE_READ))
+        return 0;
+
+    ck = kmalloc(sizeof(*ck), GFP_KERNEL);
+    if (!ck)
+        return -ENOMEM;
+
+    /* Leave private_data empty so that read reports why there is nothing */
+    if (shadow_export_checkpoint(shadow, ck)) {
+        kfree(ck);
+        return 0;
+    }
+
+    file->private_data = ck;
+    return 0;
+}
+
+static ssize_t shadow_state_read(struct file *file, char __user *buf,
+                                 size_t count, loff_t *ppos)
+{
+    struct shadow_ckpt *ck = file->private_data;
+
+    if (!ck)
+        return -ENODATA;
+
+    return simple_read_from_buffer(buf, count, ppos, ck, sizeof(*ck));
+}
+
+static int shadow_state_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    return 0;
+}
+
+/*
+ * Load a checkpoint into the shadow.  The recovery work reads saved_state
+ * without further coordination, so refuse while a recovery is running.
+ */
+static int shadow_import_checkpoint(struct network_shadow *shadow,
+                                    const struct shadow_ckpt *ck)
+{
+    int ret;
+
+    rtnl_lock();
+    /* Without the device, its REGISTER would overwrite the import anyway */
+    if (strncmp(ck->rec.name, shadow->device_name, IFNAMSIZ) != 0 || !shadow->dev)
+        ret = -ENODEV;
+    else if (shadow->recovery_in_progress)
+        ret = -EBUSY;
+    else
+        ret = import_checkpoint(ck, shadow->dev, &shadow->saved_state);
+    rtnl_unlock();
+
+    return ret;
+}
+
+static ssize_t shadow_state_write(struct file *file, const char __user *buf,
+                                  size_t count, loff_t *ppos)
+{
+    struct network_shadow *shadow = shadow_driver;
+    struct shadow_ckpt ck;
+    int ret;
+
+    if (!shadow)
+        return -EINVAL;
+
+    /* A checkpoint must be written in one go */
+    if (*ppos != 0 || count != sizeof(ck))
+        return -EINVAL;
+
+    if (copy_from_user(&ck, buf, sizeof(ck)))
+        return -EFAULT;
+
+    ret = shadow_import_checkpoint(shadow, &ck);
+    if (ret)
+        return ret;
+
+    printk(KERN_INFO "Shadow driver: Imported checkpoint for device %s\n",
+           shadow->device_name);
+    *ppos += count;
+    return count;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0)
+static const struct proc_ops shadow_state_proc_ops = {
+    .proc_open = shadow_state_open,
+    .proc_read = shadow_state_read,
+    .proc_write = shadow_state_write,
+    .proc_lseek = default_llseek,
+    .proc_release = shadow_state_release,
+};
+#else
+static const struct file_operations shadow_state_fops = {
+    .owner = THIS_MODULE,
+    .open = shadow_state_open,
+    .read = shadow_state_read,
+    .write = shadow_state_write,
+    .llseek = default_llseek,
+    .release = shadow_state_release,
+};
+#endif
+
 /* Module parameters */
 static char device_name[IFNAMSIZ] = "eth0";
 module_param_string(device, device_name, IFNAMSIZ, 0644);
 MODULE_PARM_DESC(device, "Network device to monitor (default: eth0)");
 
+/*
+ * Tear down the notifier and free the shadow.  Unregistering replays
+ * UNREGISTER for existing devices, so unpublish the shadow first; that
+ * event must not start a recovery on memory about to be freed.
+ */
+static void __maybe_unused network_shadow_detach(struct network_shadow *shadow)
+{
+    shadow_driver = NULL;
+    unregister_netdevice_notifier(&shadow->netdev_notifier);
+    cancel_work_sync(&shadow->recovery_work);
+    kfree(shadow);
+}
+
 /* Module initialization */
-static int __init network_shadow_init(void)
+static int __init __maybe_unused network_shadow_init(void)
 {
     struct network_shadow *shadow;
     struct proc_dir_entry *proc_entry;
@@ -605,9 +922,18 @@ static int __init network_shadow_init(void)
     register_tap("e1000_set_mac", shadow_ndo_set_mac_address);
     register_tap("e1000_change_mtu", shadow_ndo_change_mtu);
     
+    /* Registering replays REGISTER/UP for existing devices, so publish the
+     * shadow first or an already present device is never bound */
+    shadow_driver = shadow;
+    
     /* Register network device notifier */
     shadow->netdev_notifier.notifier_call = netdev_event;
-    register_netdevice_notifier(&shadow->netdev_notifier);
+    ret = register_netdevice_notifier(&shadow->netdev_notifier);
+    if (ret) {
+        shadow_driver = NULL;
+        kfree(shadow);
+        return ret;
+    }
     
     /* Create proc entry using the appropriate structure type */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0)
@@ -616,33 +942,43 @@ static int __init network_shadow_init(void)
     proc_entry = proc_create("network_shadow", 0644, NULL, &shadow_proc_fops);
 #endif
     if (!proc_entry) {
-        unregister_netdevice_notifier(&shadow->netdev_notifier);
-        kfree(shadow);
+        network_shadow_detach(shadow);
+        return -ENOMEM;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0)
+    proc_entry = proc_create("network_shadow_state", 0600, NULL, &shadow_state_proc_ops);
+#else
+    proc_entry = proc_create("network_shadow_state", 0600, NULL, &shadow_state_fops);
+#endif
+    if (!proc_entry) {
+        remove_proc_entry("network_shadow", NULL);
+        network_shadow_detach(shadow);
         return -ENOMEM;
     }
-    
-    shadow_driver = shadow;
     
     printk(KERN_INFO "Network Shadow Driver loaded\n");
     printk(KERN_INFO "Monitoring device: %s\n", shadow->device_name);
     return 0;
 }
 
-static void __exit network_shadow_exit(void)
+static void __exit __maybe_unused network_shadow_exit(void)
 {
     if (shadow_driver) {
-        unregister_netdevice_notifier(&shadow_driver->netdev_notifier);
+        remove_proc_entry("network_shadow_state", NULL);
         remove_proc_entry("network_shadow", NULL);
-        kfree(shadow_driver);
-        shadow_driver = NULL;
+        network_shadow_detach(shadow_driver);
     }
     
     printk(KERN_INFO "Network Shadow Driver unloaded\n");
 }
 
+/* network_shadow_test.c includes this file and supplies its own entry points */
+#ifndef NETWORK_SHADOW_KUNIT
 module_init(network_shadow_init);
 module_exit(network_shadow_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Shadow Driver Implementation");
-MODULE_DESCRIPTION("Network Shadow Driver Implementation");
\ No newline at end of file
+MODULE_DESCRIPTION("Network Shadow Driver Implementation");
+#endif
\ No newline at end of file
@@ -0,0 +1,706 @@
+/*
+ * KUnit tests and microbenchmarks for the network shadow driver.
+ *
+ * The driver keeps everything static, so the suite pulls in the driver
+ * source directly and drives the notifier, save/restore and tap wrappers
+ * against an unregistered dummy net_device.  Symbol lookup is replaced
+ * with a fake that hands out the fake "original" driver functions below.
+ */
+#define NETWORK_SHADOW_KUNIT
+#include "network_shadow.c"
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#define SHADOW_TEST_IFNAME "kunit0"
+
+/* Benchmark knobs; a non-zero budget turns the ns/op figure into a check */
+static unsigned int bench_iters = 10000;
+module_param(bench_iters, uint, 0444);
+MODULE_PARM_DESC(bench_iters, "Iterations per microbenchmark (default: 10000)");
+
+static unsigned int tap_budget_ns;
+module_param(tap_budget_ns, uint, 0444);
+MODULE_PARM_DESC(tap_budget_ns, "Fail if a tap dispatch takes longer (ns, 0 = report only)");
+
+static unsigned int snapshot_budget_ns;
+module_param(snapshot_budget_ns, uint, 0444);
+MODULE_PARM_DESC(snapshot_budget_ns, "Fail if a snapshot takes longer (ns, 0 = report only)");
+
+static unsigned int restore_budget_ns;
+module_param(restore_budget_ns, uint, 0444);
+MODULE_PARM_DESC(restore_budget_ns, "Fail if a restore takes longer (ns, 0 = report only)");
+
+static const u8 shadow_test_mac[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const u8 shadow_test_other_mac[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+struct shadow_test_ctx {
+    struct network_shadow *shadow;
+    struct net_device *dev;
+    struct net_device *new_dev;     /* Replacement device after a failure */
+};
+
+/* Call counts for the fake driver functions */
+static int orig_open_calls;
+static int orig_stop_calls;
+static int orig_set_mac_calls;
+static int orig_change_mtu_calls;
+static int orig_xmit_calls;
+static int orig_last_mtu;
+static int dev_open_calls;
+static int dev_stop_calls;
+
+/* Fake "original" driver functions handed out by the fake symbol lookup */
+static int fake_orig_open(struct net_device *dev)
+{
+    orig_open_calls++;
+    return 0;
+}
+
+static int fake_orig_stop(struct net_device *dev)
+{
+    orig_stop_calls++;
+    return 0;
+}
+
+static int fake_orig_set_mac(struct net_device *dev, void *addr)
+{
+    orig_set_mac_calls++;
+    return 0;
+}
+
+static int fake_orig_change_mtu(struct net_device *dev, int new_mtu)
+{
+    orig_change_mtu_calls++;
+    orig_last_mtu = new_mtu;
+    return 0;
+}
+
+static netdev_tx_t fake_orig_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+    orig_xmit_calls++;
+    dev_kfree_skb_any(skb);
+    return NETDEV_TX_OK;
+}
+
+static unsigned long shadow_test_lookup(const char *name)
+{
+    if (strcmp(name, "e1000_open") == 0)
+        return (unsigned long)fake_orig_open;
+    if (strcmp(name, "e1000_stop") == 0)
+        return (unsigned long)fake_orig_stop;
+    if (strcmp(name, "e1000_set_mac") == 0)
+        return (unsigned long)fake_orig_set_mac;
+    if (strcmp(name, "e1000_change_mtu") == 0)
+        return (unsigned long)fake_orig_change_mtu;
+    if (strcmp(name, "e1000_start_xmit") == 0)
+        return (unsigned long)fake_orig_xmit;
+    return 0;
+}
+
+/* netdev_ops of the dummy device, used by the restore path */
+static struct net_device_stats shadow_test_stats = {
+    .rx_packets = 42,
+    .tx_packets = 7,
+    .multicast = 5,
+    .collisions = 3,
+    .rx_crc_errors = 1,
+    .tx_compressed = 9,
+};
+
+static int shadow_test_dev_open(struct net_device *dev)
+{
+    dev_open_calls++;
+    return 0;
+}
+
+static int shadow_test_dev_stop(struct net_device *dev)
+{
+    dev_stop_calls++;
+    return 0;
+}
+
+static struct net_device_stats *shadow_test_get_stats(struct net_device *dev)
+{
+    return &shadow_test_stats;
+}
+
+static int shadow_test_get_link_ksettings(struct net_device *dev,
+                                          struct ethtool_link_ksettings *ks)
+{
+    ks->base.speed = SPEED_1000;
+    ks->base.duplex = DUPLEX_FULL;
+    ks->base.autoneg = AUTONEG_ENABLE;
+    ks->base.port = PORT_TP;
+    ethtool_link_ksettings_add_link_mode(ks, advertising, 1000baseT_Full);
+    return 0;
+}
+
+static const struct ethtool_ops shadow_test_ethtool_ops = {
+    .get_link_ksettings = shadow_test_get_link_ksettings,
+};
+
+static const struct net_device_ops shadow_test_netdev_ops = {
+    .ndo_open = shadow_test_dev_open,
+    .ndo_stop = shadow_test_dev_stop,
+    .ndo_get_stats = shadow_test_get_stats,
+};
+
+static void shadow_test_register_taps(struct kunit *test)
+{
+    KUNIT_ASSERT_EQ(test, 0, register_tap("e1000_open", shadow_ndo_open));
+    KUNIT_ASSERT_EQ(test, 0, register_tap("e1000_stop", shadow_ndo_stop));
+    KUNIT_ASSERT_EQ(test, 0, register_tap("e1000_set_mac", shadow_ndo_set_mac_address));
+    KUNIT_ASSERT_EQ(test, 0, register_tap("e1000_change_mtu", shadow_ndo_change_mtu));
+    KUNIT_ASSERT_EQ(test, 0, register_tap("e1000_start_xmit", shadow_ndo_start_xmit));
+}
+
+/* Deliver an event the way the netdevice notifier chain does, under RTNL */
+static void shadow_test_notify_dev(struct shadow_test_ctx *ctx,
+                                   struct net_device *dev, unsigned long event)
+{
+    struct netdev_notifier_info info = { .dev = dev };
+
+    rtnl_lock();
+    netdev_event(&ctx->shadow->netdev_notifier, event, &info);
+    rtnl_unlock();
+}
+
+static void shadow_test_notify(struct shadow_test_ctx *ctx, unsigned long event)
+{
+    shadow_test_notify_dev(ctx, ctx->dev, event);
+}
+
+static int shadow_test_init(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx;
+    struct network_shadow *shadow;
+    struct net_device *dev;
+
+    ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+
+    shadow = kunit_kzalloc(test, sizeof(*shadow), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, shadow);
+    shadow->state = SHADOW_PASSIVE;
+    strscpy(shadow->device_name, SHADOW_TEST_IFNAME, IFNAMSIZ);
+    INIT_WORK(&shadow->recovery_work, recovery_work_fn);
+    shadow->netdev_notifier.notifier_call = netdev_event;
+
+    dev = alloc_etherdev(0);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+    strscpy(dev->name, SHADOW_TEST_IFNAME, IFNAMSIZ);
+    dev->netdev_ops = &shadow_test_netdev_ops;
+    eth_hw_addr_set(dev, shadow_test_mac);
+    /* register_netdevice() would set this; ethtool refuses absent devices */
+    set_bit(__LINK_STATE_PRESENT, &dev->state);
+
+    ctx->shadow = shadow;
+    ctx->dev = dev;
+    test->priv = ctx;
+
+    shadow_driver = shadow;
+    kallsyms_lookup_name_func = shadow_test_lookup;
+
+    orig_open_calls = 0;
+    orig_stop_calls = 0;
+    orig_set_mac_calls = 0;
+    orig_change_mtu_calls = 0;
+    orig_xmit_calls = 0;
+    orig_last_mtu = 0;
+    dev_open_calls = 0;
+    dev_stop_calls = 0;
+
+    return 0;
+}
+
+static void shadow_test_exit(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    int i;
+
+    cancel_work_sync(&ctx->shadow->recovery_work);
+    clear_bit(__LINK_STATE_START, &ctx->dev->state);
+    free_netdev(ctx->dev);
+    if (ctx->new_dev)
+        free_netdev(ctx->new_dev);
+
+    for (i = 0; i < num_taps; i++)
+        kfree(function_taps[i].name);
+    memset(function_taps, 0, sizeof(function_taps));
+    num_taps = 0;
+
+    shadow_driver = NULL;
+    kallsyms_lookup_name_func = NULL;
+}
+
+static void shadow_test_register_saves_state(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct net_device_state *st = &ctx->shadow->saved_state;
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+
+    KUNIT_EXPECT_PTR_EQ(test, ctx->shadow->dev, ctx->dev);
+    KUNIT_EXPECT_EQ(test, ctx->shadow->state, SHADOW_PASSIVE);
+    KUNIT_EXPECT_STREQ(test, st->name, SHADOW_TEST_IFNAME);
+    KUNIT_EXPECT_EQ(test, st->mtu, ctx->dev->mtu);
+    KUNIT_EXPECT_EQ(test, st->flags, ctx->dev->flags);
+    KUNIT_EXPECT_EQ(test, 0, memcmp(st->mac_addr, shadow_test_mac, ETH_ALEN));
+    KUNIT_EXPECT_EQ(test, st->stats.rx_packets, 42UL);
+    KUNIT_EXPECT_FALSE(test, st->is_up);
+}
+
+static void shadow_test_save_captures_link_settings(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct ethtool_cmd *ecmd = &ctx->shadow->saved_state.ecmd;
+
+    ctx->dev->ethtool_ops = &shadow_test_ethtool_ops;
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+
+    KUNIT_EXPECT_EQ(test, ethtool_cmd_speed(ecmd), (u32)SPEED_1000);
+    KUNIT_EXPECT_EQ(test, ecmd->duplex, (u8)DUPLEX_FULL);
+    KUNIT_EXPECT_EQ(test, ecmd->autoneg, (u8)AUTONEG_ENABLE);
+    KUNIT_EXPECT_EQ(test, ecmd->port, (u8)PORT_TP);
+    KUNIT_EXPECT_EQ(test, ecmd->advertising, (u32)ADVERTISED_1000baseT_Full);
+}
+
+static void shadow_test_register_ignores_other_device(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+
+    strscpy(ctx->dev->name, "other0", IFNAMSIZ);
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+
+    KUNIT_EXPECT_PTR_EQ(test, ctx->shadow->dev, NULL);
+    KUNIT_EXPECT_STREQ(test, ctx->shadow->saved_state.name, "");
+}
+
+static void shadow_test_unregister_schedules_recovery(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+    shadow_test_notify(ctx, NETDEV_UNREGISTER);
+
+    KUNIT_EXPECT_PTR_EQ(test, ctx->shadow->dev, NULL);
+    KUNIT_EXPECT_EQ(test, ctx->shadow->state, SHADOW_ACTIVE);
+    KUNIT_EXPECT_TRUE(test, ctx->shadow->recovery_in_progress);
+    /* The work sleeps before touching anything, so it is still queued or running */
+    KUNIT_EXPECT_NE(test, 0U, work_busy(&ctx->shadow->recovery_work));
+}
+
+static void shadow_test_recovery_restores_state(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct net_device *dev;
+
+    ctx->dev->mtu = 1400;
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+    shadow_test_notify(ctx, NETDEV_UNREGISTER);
+
+    /* The reloaded driver brings the device back with its defaults */
+    dev = alloc_etherdev(0);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+    ctx->new_dev = dev;
+    strscpy(dev->name, SHADOW_TEST_IFNAME, IFNAMSIZ);
+    dev->netdev_ops = &shadow_test_netdev_ops;
+    eth_hw_addr_set(dev, shadow_test_other_mac);
+
+    shadow_test_notify_dev(ctx, dev, NETDEV_REGISTER);
+    shadow_test_notify_dev(ctx, dev, NETDEV_UP);
+
+    /* The defaults must not replace the snapshot taken before the failure */
+    KUNIT_EXPECT_PTR_EQ(test, ctx->shadow->dev, dev);
+    KUNIT_EXPECT_EQ(test, ctx->shadow->saved_state.mtu, 1400U);
+
+    flush_work(&ctx->shadow->recovery_work);
+
+    KUNIT_EXPECT_FALSE(test, ctx->shadow->recovery_in_progress);
+    KUNIT_EXPECT_EQ(test, ctx->shadow->state, SHADOW_PASSIVE);
+    KUNIT_EXPECT_EQ(test, dev->mtu, 1400U);
+    KUNIT_EXPECT_EQ(test, 0, memcmp(dev->dev_addr, shadow_test_mac, ETH_ALEN));
+}
+
+static void shadow_test_up_down_resave(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct net_device_state *st = &ctx->shadow->saved_state;
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+
+    ctx->dev->mtu = 9000;
+    set_bit(__LINK_STATE_START, &ctx->dev->state);
+    shadow_test_notify(ctx, NETDEV_UP);
+    KUNIT_EXPECT_EQ(test, st->mtu, 9000U);
+    KUNIT_EXPECT_TRUE(test, st->is_up);
+
+    ctx->dev->mtu = 1400;
+    shadow_test_notify(ctx, NETDEV_DOWN);
+    KUNIT_EXPECT_EQ(test, st->mtu, 1400U);
+
+    /* A DOWN seen while recovering must not clobber the snapshot */
+    ctx->shadow->recovery_in_progress = true;
+    ctx->dev->mtu = 1300;
+    shadow_test_notify(ctx, NETDEV_DOWN);
+    KUNIT_EXPECT_EQ(test, st->mtu, 1400U);
+}
+
+static void shadow_test_restore_applies_state(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    unsigned int flags = ctx->dev->flags;
+    unsigned int mtu = ctx->dev->mtu;
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+
+    ctx->dev->mtu = 576;
+    ctx->dev->flags = 0;
+    eth_hw_addr_set(ctx->dev, shadow_test_other_mac);
+
+    KUNIT_EXPECT_EQ(test, 0, restore_device_state(ctx->dev));
+    KUNIT_EXPECT_EQ(test, ctx->dev->mtu, mtu);
+    KUNIT_EXPECT_EQ(test, ctx->dev->flags, flags);
+    KUNIT_EXPECT_EQ(test, 0, memcmp(ctx->dev->dev_addr, shadow_test_mac, ETH_ALEN));
+    KUNIT_EXPECT_EQ(test, dev_open_calls, 0);
+}
+
+static void shadow_test_restore_reopens_device(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+    ctx->shadow->saved_state.is_up = true;
+
+    KUNIT_EXPECT_EQ(test, 0, restore_device_state(ctx->dev));
+    KUNIT_EXPECT_EQ(test, dev_open_calls, 1);
+    KUNIT_EXPECT_EQ(test, dev_stop_calls, 0);
+}
+
+static void shadow_test_wrappers_passive(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    unsigned int mtu = ctx->dev->mtu;
+    u8 addr[ETH_ALEN];
+
+    memcpy(addr, shadow_test_other_mac, ETH_ALEN);
+    shadow_test_register_taps(test);
+    ctx->shadow->state = SHADOW_PASSIVE;
+
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_open(ctx->dev));
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_stop(ctx->dev));
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_set_mac_address(ctx->dev, addr));
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_change_mtu(ctx->dev, 1234));
+
+    /* Everything goes to the original driver, which leaves the device alone */
+    KUNIT_EXPECT_EQ(test, orig_open_calls, 1);
+    KUNIT_EXPECT_EQ(test, orig_stop_calls, 1);
+    KUNIT_EXPECT_EQ(test, orig_set_mac_calls, 1);
+    KUNIT_EXPECT_EQ(test, orig_change_mtu_calls, 1);
+    KUNIT_EXPECT_EQ(test, orig_last_mtu, 1234);
+    KUNIT_EXPECT_EQ(test, ctx->dev->mtu, mtu);
+    KUNIT_EXPECT_EQ(test, 0, memcmp(ctx->dev->dev_addr, shadow_test_mac, ETH_ALEN));
+}
+
+static void shadow_test_wrappers_active(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    u8 addr[ETH_ALEN];
+
+    memcpy(addr, shadow_test_other_mac, ETH_ALEN);
+    shadow_test_register_taps(test);
+    ctx->shadow->state = SHADOW_ACTIVE;
+
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_open(ctx->dev));
+    KUNIT_EXPECT_TRUE(test, netif_carrier_ok(ctx->dev));
+
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_change_mtu(ctx->dev, 9000));
+    KUNIT_EXPECT_EQ(test, ctx->dev->mtu, 9000U);
+    KUNIT_EXPECT_EQ(test, -EINVAL, shadow_ndo_change_mtu(ctx->dev, 20));
+    KUNIT_EXPECT_EQ(test, ctx->dev->mtu, 9000U);
+
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_set_mac_address(ctx->dev, addr));
+    KUNIT_EXPECT_EQ(test, 0, memcmp(ctx->dev->dev_addr, shadow_test_other_mac, ETH_ALEN));
+    set_bit(__LINK_STATE_START, &ctx->dev->state);
+    KUNIT_EXPECT_EQ(test, -EBUSY, shadow_ndo_set_mac_address(ctx->dev, addr));
+
+    KUNIT_EXPECT_EQ(test, 0, shadow_ndo_stop(ctx->dev));
+    KUNIT_EXPECT_FALSE(test, netif_carrier_ok(ctx->dev));
+
+    /* The shadow handles the calls itself while active */
+    KUNIT_EXPECT_EQ(test, orig_open_calls, 0);
+    KUNIT_EXPECT_EQ(test, orig_stop_calls, 0);
+    KUNIT_EXPECT_EQ(test, orig_set_mac_calls, 0);
+    KUNIT_EXPECT_EQ(test, orig_change_mtu_calls, 0);
+}
+
+static void shadow_test_xmit_passive_reaches_driver(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct sk_buff *skb;
+
+    shadow_test_register_taps(test);
+    ctx->shadow->state = SHADOW_PASSIVE;
+
+    skb = alloc_skb(ETH_ZLEN, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, skb);
+
+    /* The original driver consumes the skb */
+    KUNIT_EXPECT_EQ(test, NETDEV_TX_OK, shadow_ndo_start_xmit(skb, ctx->dev));
+    KUNIT_EXPECT_EQ(test, orig_xmit_calls, 1);
+}
+
+static void shadow_test_xmit_active_drops(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct sk_buff *skb;
+
+    shadow_test_register_taps(test);
+    ctx->shadow->state = SHADOW_ACTIVE;
+
+    skb = alloc_skb(ETH_ZLEN, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, skb);
+
+    /* The shadow frees the skb itself and reports success */
+    KUNIT_EXPECT_EQ(test, NETDEV_TX_OK, shadow_ndo_start_xmit(skb, ctx->dev));
+    KUNIT_EXPECT_EQ(test, orig_xmit_calls, 0);
+}
+
+static void shadow_test_wrappers_without_tap(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+
+    KUNIT_EXPECT_EQ(test, -EINVAL, shadow_ndo_open(ctx->dev));
+    KUNIT_EXPECT_EQ(test, -EINVAL, shadow_ndo_stop(ctx->dev));
+    KUNIT_EXPECT_EQ(test, -EINVAL, shadow_ndo_change_mtu(ctx->dev, 1500));
+}
+
+static void shadow_test_ckpt_crc_is_standard(struct kunit *test)
+{
+    /* The CRC-32 check value from the usual catalogue */
+    KUNIT_EXPECT_EQ(test, 0xcbf43926U, shadow_ckpt_crc("123456789", 9));
+}
+
+static void shadow_test_ckpt_round_trip(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct net_device_state *st = &ctx->shadow->saved_state;
+    struct net_device_state *copy;
+    struct shadow_ckpt *ck;
+
+    ck = kunit_kzalloc(test, sizeof(*ck), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ck);
+    copy = kunit_kzalloc(test, sizeof(*copy), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, copy);
+
+    /* Feature bits above 31 must survive the round trip */
+    ctx->dev->features = (netdev_features_t)1 << 40 | NETIF_F_SG;
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+    export_checkpoint(st, ck);
+
+    KUNIT_ASSERT_EQ(test, 0, import_checkpoint(ck, ctx->dev, copy));
+    KUNIT_EXPECT_STREQ(test, copy->name, st->name);
+    KUNIT_EXPECT_EQ(test, 0, memcmp(copy->mac_addr, st->mac_addr, ETH_ALEN));
+    KUNIT_EXPECT_EQ(test, 0, memcmp(copy->perm_addr, st->perm_addr, ETH_ALEN));
+    KUNIT_EXPECT_EQ(test, copy->mtu, st->mtu);
+    KUNIT_EXPECT_EQ(test, copy->flags, st->flags);
+    KUNIT_EXPECT_EQ(test, copy->features, st->features);
+    KUNIT_EXPECT_EQ(test, copy->tx_queue_len, st->tx_queue_len);
+    KUNIT_EXPECT_EQ(test, copy->is_up, st->is_up);
+    /* Every counter, not just the common ones */
+    KUNIT_EXPECT_EQ(test, 0, memcmp(&copy->stats, &st->stats, sizeof(st->stats)));
+    KUNIT_EXPECT_EQ(test, copy->stats.tx_compressed, 9UL);
+
+    /* A flipped payload bit is caught by the CRC */
+    ck->rec.mtu ^= cpu_to_le32(1);
+    KUNIT_EXPECT_EQ(test, -EBADMSG, import_checkpoint(ck, ctx->dev, copy));
+}
+
+static void shadow_test_ckpt_export_needs_saved_state(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct shadow_ckpt *ck;
+
+    ck = kunit_kzalloc(test, sizeof(*ck), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ck);
+
+    KUNIT_EXPECT_EQ(test, -ENODATA, shadow_export_checkpoint(ctx->shadow, ck));
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+    KUNIT_EXPECT_EQ(test, 0, shadow_export_checkpoint(ctx->shadow, ck));
+    KUNIT_EXPECT_STREQ(test, ck->rec.name, SHADOW_TEST_IFNAME);
+}
+
+static void shadow_test_ckpt_rejects_bad_payload(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct net_device_state *st = &ctx->shadow->saved_state;
+    struct net_device_state *copy;
+    struct shadow_ckpt *ck;
+
+    ck = kunit_kzalloc(test, sizeof(*ck), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ck);
+    copy = kunit_kzalloc(test, sizeof(*copy), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, copy);
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+
+    /* Each checkpoint carries a valid CRC, only the content is wrong */
+    st->mtu = ctx->dev->min_mtu - 1;
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, -EINVAL, import_checkpoint(ck, ctx->dev, copy));
+    st->mtu = ctx->dev->max_mtu + 1;
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, -EINVAL, import_checkpoint(ck, ctx->dev, copy));
+
+    /* Jumbo frames are fine when the device supports them */
+    ctx->dev->max_mtu = 9216;
+    st->mtu = 9216;
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, 0, import_checkpoint(ck, ctx->dev, copy));
+    st->mtu = 1500;
+
+    memset(st->mac_addr, 0, ETH_ALEN);
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, -EINVAL, import_checkpoint(ck, ctx->dev, copy));
+    memcpy(st->mac_addr, shadow_test_mac, ETH_ALEN);
+
+    st->flags |= 1U << 31;
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, -EINVAL, import_checkpoint(ck, ctx->dev, copy));
+    st->flags &= ~(1U << 31);
+
+    st->tx_queue_len = (unsigned int)INT_MAX + 1;
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, -EINVAL, import_checkpoint(ck, ctx->dev, copy));
+    st->tx_queue_len = DEFAULT_TX_QUEUE_LEN;
+
+    export_checkpoint(st, ck);
+    KUNIT_EXPECT_EQ(test, 0, import_checkpoint(ck, ctx->dev, copy));
+}
+
+static void shadow_test_ckpt_import_refused_during_recovery(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    struct shadow_ckpt *ck;
+
+    ck = kunit_kzalloc(test, sizeof(*ck), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ck);
+
+    shadow_test_notify(ctx, NETDEV_REGISTER);
+    export_checkpoint(&ctx->shadow->saved_state, ck);
+
+    ctx->shadow->recovery_in_progress = true;
+    KUNIT_EXPECT_EQ(test, -EBUSY, shadow_import_checkpoint(ctx->shadow, ck));
+    ctx->shadow->recovery_in_progress = false;
+    KUNIT_EXPECT_EQ(test, 0, shadow_import_checkpoint(ctx->shadow, ck));
+
+    /* The named device must be present and bound */
+    ctx->shadow->dev = NULL;
+    KUNIT_EXPECT_EQ(test, -ENODEV, shadow_import_checkpoint(ctx->shadow, ck));
+    ctx->shadow->dev = ctx->dev;
+
+    strscpy(ctx->shadow->device_name, "other0", IFNAMSIZ);
+    KUNIT_EXPECT_EQ(test, -ENODEV, shadow_import_checkpoint(ctx->shadow, ck));
+}
+
+/* Microbenchmarks: report ns/op, and check it when a budget is given */
+static void shadow_bench_report(struct kunit *test, const char *what,
+                                u64 total_ns, unsigned int iters,
+                                unsigned int budget_ns)
+{
+    u64 per_op = div_u64(total_ns, iters);
+
+    kunit_info(test, "%s: %llu ns/op over %u iterations\n", what, per_op, iters);
+    if (budget_ns)
+        KUNIT_EXPECT_LE(test, per_op, (u64)budget_ns);
+}
+
+static void shadow_bench_tap_dispatch(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    unsigned int i;
+    u64 start;
+
+    KUNIT_ASSERT_GT(test, bench_iters, 0U);
+    shadow_test_register_taps(test);
+    ctx->shadow->state = SHADOW_PASSIVE;
+
+    start = ktime_get_ns();
+    for (i = 0; i < bench_iters; i++)
+        shadow_ndo_open(ctx->dev);
+    shadow_bench_report(test, "tap dispatch", ktime_get_ns() - start,
+                        bench_iters, tap_budget_ns);
+
+    KUNIT_EXPECT_EQ(test, orig_open_calls, (int)bench_iters);
+}
+
+static void shadow_bench_snapshot(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    unsigned int i;
+    u64 start;
+
+    KUNIT_ASSERT_GT(test, bench_iters, 0U);
+
+    start = ktime_get_ns();
+    for (i = 0; i < bench_iters; i++)
+        save_device_state(ctx->dev);
+    shadow_bench_report(test, "snapshot", ktime_get_ns() - start,
+                        bench_iters, snapshot_budget_ns);
+}
+
+static void shadow_bench_restore(struct kunit *test)
+{
+    struct shadow_test_ctx *ctx = test->priv;
+    unsigned int i;
+    u64 start;
+
+    KUNIT_ASSERT_GT(test, bench_iters, 0U);
+    save_device_state(ctx->dev);
+
+    start = ktime_get_ns();
+    for (i = 0; i < bench_iters; i++)
+        restore_device_state(ctx->dev);
+    shadow_bench_report(test, "restore", ktime_get_ns() - start,
+                        bench_iters, restore_budget_ns);
+}
+
+static struct kunit_case network_shadow_test_cases[] = {
+    KUNIT_CASE(shadow_test_register_saves_state),
+    KUNIT_CASE(shadow_test_save_captures_link_settings),
+    KUNIT_CASE(shadow_test_register_ignores_other_device),
+    KUNIT_CASE(shadow_test_unregister_schedules_recovery),
+    KUNIT_CASE(shadow_test_recovery_restores_state),
+    KUNIT_CASE(shadow_test_up_down_resave),
+    KUNIT_CASE(shadow_test_restore_applies_state),
+    KUNIT_CASE(shadow_test_restore_reopens_device),
+    KUNIT_CASE(shadow_test_wrappers_passive),
+    KUNIT_CASE(shadow_test_wrappers_active),
+    KUNIT_CASE(shadow_test_xmit_passive_reaches_driver),
+    KUNIT_CASE(shadow_test_xmit_active_drops),
+    KUNIT_CASE(shadow_test_wrappers_without_tap),
+    KUNIT_CASE(shadow_test_ckpt_crc_is_standard),
+    KUNIT_CASE(shadow_test_ckpt_round_trip),
+    KUNIT_CASE(shadow_test_ckpt_export_needs_saved_state),
+    KUNIT_CASE(shadow_test_ckpt_rejects_bad_payload),
+    KUNIT_CASE(shadow_test_ckpt_import_refused_during_recovery),
+    KUNIT_CASE(shadow_bench_tap_dispatch),
+    KUNIT_CASE(shadow_bench_snapshot),
+    KUNIT_CASE(shadow_bench_restore),
+    {}
+};
+
+static struct kunit_suite network_shadow_test_suite = {
+    .name = "network_shadow",
+    .init = shadow_test_init,
+    .exit = shadow_test_exit,
+    .test_cases = network_shadow_test_cases,
+};
+
+kunit_test_suite(network_shadow_test_suite);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("KUnit tests for the Network Shadow Driver");